@@ -15,6 +15,8 @@
 #include <iostream>
 #include <stdexcept>
 #include <set>
+#include <memory>
+#include <atomic>
 
 namespace automata_stuff {
     struct hash {
@@ -26,10 +28,43 @@ namespace automata_stuff {
             return seed;
         }
     };
+
+    // Publication slot for immutable snapshots. Before C++20 it goes through the free atomic_load/atomic_store,
+    // which libstdc++ implements with a global mutex pool, so load() briefly takes a lock there.
+    template<typename T>
+    class atomic_snapshot {
+    public:
+        std::shared_ptr<const T> load() const {
+#if __cpp_lib_atomic_shared_ptr
+            return ptr.load(std::memory_order_acquire);
+#else
+            return std::atomic_load_explicit(&ptr, std::memory_order_acquire);
+#endif
+        }
+
+        void store(std::shared_ptr<const T> value) {
+#if __cpp_lib_atomic_shared_ptr
+            ptr.store(std::move(value), std::memory_order_release);
+#else
+            std::atomic_store_explicit(&ptr, std::move(value), std::memory_order_release);
+#endif
+        }
+
+    private:
+#if __cpp_lib_atomic_shared_ptr
+        std::atomic<std::shared_ptr<const T>> ptr;
+#else
+        std::shared_ptr<const T> ptr;
+#endif
+    };
 }
 
+template<typename T>
+class IncrementalDFA;
+
 template<typename T=char>
 class Automata {
+    friend class IncrementalDFA<T>;
 public:
     explicit Automata(T epsilon_symbol): epsilon_transition_symbol(epsilon_symbol) {
         initial_state = 0;
@@ -273,4 +308,307 @@ private:
 
 };
 
+/* INCREMENTAL DETERMINIZATION */
+
+// Keeps the source NFA next to its subset construction. Every DFA state remembers the (eps-closed) set
+// of NFA states it was built from, so an edit of NFA state v only re-determinizes DFA states holding v,
+// or, for eps edges, the DFA states leading into them. publish() walks the DFA from the root, recomputes
+// the dirty subsets it reaches and reclaims the ones it does not; freed ids are reused later.
+// Edits and publish() must come from one writer thread. Readers take snapshot() and match on it without
+// locks, an old snapshot stays valid until its last reader drops it. Unchanged rows are shared between
+// snapshots. snapshot() itself may briefly lock, see automata_stuff::atomic_snapshot.
+template<typename T=char>
+class IncrementalDFA {
+    struct Row {
+        bool is_terminal = false;
+        std::map<T, size_t> transitions;
+    };
+
+public:
+    class Snapshot {
+    public:
+        template <typename IterType>
+        bool accepts(IterType iter, IterType end) const {
+            size_t v = root;
+            while (iter != end) {
+                auto it = rows[v]->transitions.find(*iter);
+                if (it == rows[v]->transitions.end())
+                    return false;
+                v = it->second;
+                ++iter;
+            }
+            return rows[v]->is_terminal;
+        }
+
+        bool accepts(const std::string& word) const {
+            return accepts(word.begin(), word.end());
+        }
+
+        // number of live DFA states
+        size_t size() const {
+            return live;
+        }
+
+    private:
+        friend class IncrementalDFA<T>;
+
+        size_t root = 0;
+        size_t live = 0;
+        std::vector<std::shared_ptr<const Row>> rows;
+    };
+
+    using Matcher = std::shared_ptr<const Snapshot>;
+
+    explicit IncrementalDFA(T epsilon_symbol): nfa(epsilon_symbol) {
+        root = intern(closure({nfa.initial_state}));
+        publish();
+    }
+
+    size_t begin() {
+        return nfa.begin();
+    }
+
+    size_t add_state(bool is_terminal = false) {
+        return nfa.add_state(is_terminal);
+    }
+
+    void add_transition(size_t from, T label, size_t to, bool is_terminal = false) {
+        nfa.add_transition(from, label, to, is_terminal);
+        if (label == nfa.epsilon_transition_symbol)
+            reclose(from);
+        else
+            touch(from);
+        if (is_terminal)
+            refresh_terminal(nfa.at(to));
+    }
+
+    void toggle_terminal(size_t state) {
+        nfa.toggle_terminal(state);
+        refresh_terminal(state);
+    }
+
+    void drop_transition(size_t from, T label, size_t to) {
+        nfa.drop_transition(from, label, to);
+        if (label == nfa.epsilon_transition_symbol)
+            reclose(from);
+        else
+            touch(from);
+    }
+
+    // Subsets waiting to be re-determinized by the next publish()
+    size_t pending() const {
+        return dirty_cnt;
+    }
+
+    // Recompute dirty subsets, reclaim unreachable ones and swap in the new matcher
+    void publish() {
+        if (!changed) return;
+
+        if (root_stale) {
+            root = intern(closure({nfa.initial_state}));
+            root_stale = false;
+        }
+        sweep();
+
+        auto snapshot = std::make_shared<Snapshot>();
+        snapshot->root = root;
+        snapshot->live = subsets.size() - free_ids.size();
+        snapshot->rows.reserve(subsets.size());
+        for (auto& subset : subsets)
+            snapshot->rows.push_back(subset.row);
+        matcher.store(std::move(snapshot));
+        changed = false;
+    }
+
+    Matcher snapshot() const {
+        return matcher.load();
+    }
+
+private:
+
+    struct Subset {
+        std::set<size_t> nfa_states;
+        bool is_live = false;
+        bool is_dirty = false;
+        bool is_terminal = false;
+        std::shared_ptr<const Row> row;
+        std::multiset<size_t> preds; // one entry per incoming transition
+    };
+
+    std::set<size_t> closure(std::set<size_t> vset) {
+        std::set<size_t> result;
+        for (size_t v : vset) {
+            if (!result.count(v))
+                nfa.dfs_(result, v);
+        }
+        return result;
+    }
+
+    size_t intern(std::set<size_t>&& vset) {
+        auto found = index.find(vset);
+        if (found != index.end())
+            return found->second;
+
+        size_t id;
+        if (free_ids.empty()) {
+            id = subsets.size();
+            subsets.emplace_back();
+        } else {
+            id = free_ids.back();
+            free_ids.pop_back();
+        }
+
+        Subset& subset = subsets[id];
+        for (size_t v : vset) {
+            subset.is_terminal |= nfa.states[v].is_terminal;
+            dependents[v].insert(id);
+        }
+        index.insert({vset, id});
+        subset.nfa_states = std::move(vset);
+        subset.is_live = true;
+        mark_dirty(id);
+        return id;
+    }
+
+    void mark_dirty(size_t id) {
+        changed = true;
+        if (subsets[id].is_dirty) return;
+        subsets[id].is_dirty = true;
+        ++dirty_cnt;
+    }
+
+    // Labeled edges out of nfa_state changed: subsets holding it get new transitions
+    void touch(size_t nfa_state) {
+        auto found = dependents.find(nfa_state);
+        if (found == dependents.end()) return;
+        for (size_t id : found->second)
+            mark_dirty(id);
+    }
+
+    // Eps edges out of nfa_state changed, so subsets holding it are not closures anymore.
+    // Their predecessors are re-determinized into the new closures, the old subsets go to the sweep
+    void reclose(size_t nfa_state) {
+        auto found = dependents.find(nfa_state);
+        if (found == dependents.end()) return;
+        for (size_t id : found->second) {
+            if (id == root) {
+                root_stale = true;
+                changed = true;
+            }
+            for (size_t pred : subsets[id].preds)
+                mark_dirty(pred);
+        }
+    }
+
+    void refresh_terminal(size_t nfa_state) {
+        auto found = dependents.find(nfa_state);
+        if (found == dependents.end()) return;
+        for (size_t id : found->second) {
+            Subset& subset = subsets[id];
+            bool is_terminal = false;
+            for (size_t v : subset.nfa_states)
+                is_terminal |= nfa.states[v].is_terminal;
+            if (is_terminal == subset.is_terminal) continue;
+
+            subset.is_terminal = is_terminal;
+            changed = true;
+            if (subset.row && !subset.is_dirty) {
+                auto row = std::make_shared<Row>(*subset.row);
+                row->is_terminal = is_terminal;
+                subset.row = std::move(row);
+            }
+        }
+    }
+
+    void determinize(size_t id) {
+        auto row = std::make_shared<Row>();
+        row->is_terminal = subsets[id].is_terminal;
+        for (auto& label : nfa.alphabet) {
+            if (label == nfa.epsilon_transition_symbol) continue;
+            std::set<size_t> to_vset;
+            for (size_t v : subsets[id].nfa_states) {
+                auto range = nfa.states[v].transitions.equal_range(typename Automata<T>::Transition(label));
+                for (auto i = range.first; i != range.second; ++i)
+                    to_vset.insert(i->second);
+            }
+            if (to_vset.empty()) continue;
+            // intern() may grow subsets, so no references are held across it
+            row->transitions.insert({label, intern(closure(std::move(to_vset)))});
+        }
+
+        unlink(id);
+        for (auto& [label, to] : row->transitions)
+            subsets[to].preds.insert(id);
+        subsets[id].row = std::move(row);
+        subsets[id].is_dirty = false;
+        --dirty_cnt;
+    }
+
+    // drop id from the preds of its current targets
+    void unlink(size_t id) {
+        if (!subsets[id].row) return;
+        for (auto& [label, to] : subsets[id].row->transitions) {
+            auto& preds = subsets[to].preds;
+            auto found = preds.find(id);
+            if (found != preds.end())
+                preds.erase(found);
+        }
+    }
+
+    // Walk from the root re-determinizing dirty subsets on the way; whatever is not reached is reclaimed,
+    // so dirty but unreachable subsets are never recomputed
+    void sweep() {
+        std::vector<bool> reached(subsets.size(), false);
+        std::vector<size_t> stack = {root};
+        reached[root] = true;
+
+        while (!stack.empty()) {
+            size_t id = stack.back(); stack.pop_back();
+            if (subsets[id].is_dirty)
+                determinize(id);
+            reached.resize(subsets.size(), false);
+            for (auto& [label, to] : subsets[id].row->transitions) {
+                if (!reached[to]) {
+                    reached[to] = true;
+                    stack.push_back(to);
+                }
+            }
+        }
+
+        for (size_t id = 0; id < subsets.size(); ++id) {
+            if (subsets[id].is_live && !reached[id])
+                reclaim(id);
+        }
+    }
+
+    void reclaim(size_t id) {
+        unlink(id);
+        Subset& subset = subsets[id];
+        for (size_t v : subset.nfa_states) {
+            auto found = dependents.find(v);
+            found->second.erase(id);
+            if (found->second.empty())
+                dependents.erase(found);
+        }
+        index.erase(subset.nfa_states);
+        if (subset.is_dirty)
+            --dirty_cnt;
+        subset = Subset();
+        free_ids.push_back(id);
+    }
+
+    Automata<T> nfa;
+    automata_stuff::atomic_snapshot<Snapshot> matcher;
+
+    std::vector<Subset> subsets;
+    std::vector<size_t> free_ids;
+    std::unordered_map<std::set<size_t>, size_t, automata_stuff::hash> index;
+    std::unordered_map<size_t, std::set<size_t>> dependents;
+
+    size_t root = 0;
+    size_t dirty_cnt = 0;
+    bool root_stale = false;
+    bool changed = false;
+};
+
 #endif //PROJECT_Automata_AUTOMATA_H
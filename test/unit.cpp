@@ -1,5 +1,8 @@
 #include "automata.h"
 #include <gtest/gtest.h>
+#include <atomic>
+#include <random>
+#include <thread>
 
 TEST(SimpleTests, ReadTransformOperations) {
     // SimpleTest1
@@ -91,6 +94,186 @@ TEST(NotSimpleTests, ReadTransformOperations) {
 
 }
 
+TEST(IncrementalTests, UpdateAndSwap) {
+    IncrementalDFA<char> a('#');
+    a.add_transition(a.begin(), 'a', 1);
+    a.add_transition(1, 'b', a.begin());
+    a.add_transition(a.begin(), 'c', 2, true);
+    a.publish();
+
+    auto old = a.snapshot();
+    EXPECT_TRUE(old->accepts("ababc"));
+    EXPECT_FALSE(old->accepts("ababd"));
+
+    a.add_transition(2, 'd', 2);
+    a.toggle_terminal(a.begin());
+    a.publish();
+
+    auto cur = a.snapshot();
+    EXPECT_TRUE(cur->accepts("abcddd"));
+    EXPECT_TRUE(cur->accepts("abab"));
+    EXPECT_FALSE(old->accepts("abcddd"));
+    EXPECT_FALSE(old->accepts("abab"));
+
+    a.drop_transition(1, 'b', a.begin());
+    a.publish();
+    EXPECT_FALSE(a.snapshot()->accepts("ababc"));
+    EXPECT_TRUE(cur->accepts("ababc"));
+
+    // eps edge: only the root, leading into the subset holding state 1, is re-determinized
+    a.add_transition(1, '#', 2);
+    EXPECT_EQ(a.pending(), 1);
+    a.publish();
+    EXPECT_EQ(a.pending(), 0);
+    EXPECT_TRUE(a.snapshot()->accepts("add"));
+    EXPECT_TRUE(a.snapshot()->accepts("c"));
+    EXPECT_FALSE(a.snapshot()->accepts("ab"));
+}
+
+struct Edge {
+    size_t from;
+    char label;
+    size_t to;
+};
+
+static void build(IncrementalDFA<char>& a, size_t states, const std::vector<Edge>& edges, const std::vector<bool>& terminal) {
+    for (size_t i = 1; i < states; ++i)
+        a.add_state(terminal[i]);
+    if (terminal[0])
+        a.toggle_terminal(0);
+    for (auto& e : edges)
+        a.add_transition(e.from, e.label, e.to);
+    a.publish();
+}
+
+TEST(IncrementalTests, RoundTripMatchesRebuild) {
+    const size_t n = 21;
+    std::vector<Edge> chain;
+    for (size_t i = 0; i + 1 < n; ++i)
+        chain.push_back({i, 'a', i + 1});
+    std::vector<bool> terminal(n, false);
+    terminal[n - 1] = true;
+
+    IncrementalDFA<char> a('#');
+    build(a, n, chain, terminal);
+    IncrementalDFA<char> fresh('#');
+    build(fresh, n, chain, terminal);
+    ASSERT_EQ(a.snapshot()->size(), fresh.snapshot()->size());
+
+    for (size_t round = 0; round < 200; ++round) {
+        size_t k = 1 + round % (n - 1);
+        char label = round % 2 ? 'a' : '#';
+        a.add_transition(k, label, 0);
+        a.publish();
+        a.drop_transition(k, label, 0);
+        a.publish();
+        ASSERT_EQ(a.snapshot()->size(), fresh.snapshot()->size());
+        ASSERT_TRUE(a.snapshot()->accepts(std::string(n - 1, 'a')));
+        ASSERT_FALSE(a.snapshot()->accepts(std::string(n, 'a')));
+    }
+}
+
+TEST(IncrementalTests, UnreachableEditIsNoop) {
+    IncrementalDFA<char> a('#');
+    a.add_transition(a.begin(), 'a', 1, true);
+    size_t island = a.add_state();
+    a.publish();
+    auto before = a.snapshot();
+
+    a.add_transition(island, 'b', 1);
+    a.add_transition(island, '#', a.begin());
+    a.toggle_terminal(island);
+    EXPECT_EQ(a.pending(), 0);
+    a.publish();
+    EXPECT_EQ(a.snapshot(), before);
+
+    // the edit touches only the subset holding state 1
+    a.add_transition(1, 'b', 1);
+    EXPECT_EQ(a.pending(), 1);
+    a.publish();
+    EXPECT_TRUE(a.snapshot()->accepts("abbb"));
+}
+
+TEST(IncrementalTests, RandomEditsMatchRebuild) {
+    const size_t n = 6;
+    const std::string labels = "ab#";
+    std::mt19937 gen(26);
+    std::vector<Edge> edges;
+    std::vector<bool> terminal(n, false);
+
+    IncrementalDFA<char> a('#');
+    build(a, n, edges, terminal);
+
+    for (int step = 0; step < 300; ++step) {
+        int op = gen() % 4;
+        if (op == 0 && !edges.empty()) {
+            size_t i = gen() % edges.size();
+            a.drop_transition(edges[i].from, edges[i].label, edges[i].to);
+            edges.erase(edges.begin() + i);
+        } else if (op == 1) {
+            size_t v = gen() % n;
+            a.toggle_terminal(v);
+            terminal[v] = !terminal[v];
+        } else {
+            Edge e{gen() % n, labels[gen() % labels.size()], gen() % n};
+            a.add_transition(e.from, e.label, e.to);
+            edges.push_back(e);
+        }
+        a.publish();
+
+        IncrementalDFA<char> fresh('#');
+        build(fresh, n, edges, terminal);
+        auto got = a.snapshot();
+        auto expected = fresh.snapshot();
+        ASSERT_EQ(got->size(), expected->size());
+        for (size_t len = 0; len <= 4; ++len) {
+            for (size_t mask = 0; mask < (1u << len); ++mask) {
+                std::string word;
+                for (size_t i = 0; i < len; ++i)
+                    word += (mask >> i & 1) ? 'b' : 'a';
+                ASSERT_EQ(got->accepts(word), expected->accepts(word)) << word;
+            }
+        }
+    }
+}
+
+// run with -DENABLE_TSAN=ON to check readers against the writer
+TEST(IncrementalTests, ReadersDuringPublish) {
+    IncrementalDFA<char> a('#');
+    a.add_transition(a.begin(), 'a', 1);
+    a.add_transition(1, 'b', a.begin(), true);
+    a.publish();
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> reads{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&] {
+            while (!stop.load()) {
+                auto matcher = a.snapshot();
+                // "ab" is accepted by every published version
+                EXPECT_TRUE(matcher->accepts("ab"));
+                EXPECT_FALSE(matcher->accepts("ba"));
+                ++reads;
+            }
+        });
+    }
+
+    for (int round = 0; round < 200; ++round) {
+        a.add_transition(1, 'c', 2, true);
+        a.add_transition(a.begin(), '#', 2);
+        a.publish();
+        a.drop_transition(a.begin(), '#', 2);
+        a.drop_transition(1, 'c', 2);
+        a.publish();
+    }
+    while (reads.load() < 100)
+        std::this_thread::yield();
+    stop = true;
+    for (auto& reader : readers)
+        reader.join();
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();